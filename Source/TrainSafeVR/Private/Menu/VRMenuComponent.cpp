@@ -0,0 +1,520 @@
+// Copyright © 2024 Luis M. Infante
+// Licensed under the GNU General Public License v3.0 (GPLv3).
+// See the full license at https://www.gnu.org/licenses/gpl-3.0.html.
+
+
+#include "Menu/VRMenuComponent.h"
+
+#include "Blueprint/UserWidget.h"
+#include "Components/WidgetComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PlayerController.h"
+#include "InputCoreTypes.h"
+#include "Menu/VRMenuInteractionComponent.h"
+#include "MotionControllerComponent.h"
+#include "NiagaraComponent.h"
+#include "NiagaraDataInterfaceArrayFunctionLibrary.h"
+#include "NiagaraFunctionLibrary.h"
+#include "NiagaraSystem.h"
+#include "Widgets/SWidget.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogVRMenu, Log, All);
+
+// Profile in headset with "stat VRMenu"
+DECLARE_STATS_GROUP(TEXT("VRMenu"), STATGROUP_VRMenu, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Toggle Menu"), STAT_VRMenuToggle, STATGROUP_VRMenu);
+DECLARE_CYCLE_STAT(TEXT("Tick"), STAT_VRMenuTick, STATGROUP_VRMenu);
+DECLARE_CYCLE_STAT(TEXT("Laser Trace"), STAT_VRMenuLaserTrace, STATGROUP_VRMenu);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Last Open To First Draw (ms)"), STAT_VRMenuToggleLatency, STATGROUP_VRMenu);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Menu Redraws"), STAT_VRMenuRedraws, STATGROUP_VRMenu);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Menus"), STAT_VRMenuPoolSize, STATGROUP_VRMenu);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Menus Created"), STAT_VRMenuCreated, STATGROUP_VRMenu);
+
+UVRMenuComponent::UVRMenuComponent()
+{
+	// Only ticks while a menu is open
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	// Only enabled between opening a menu and that menu's first draw
+	MenuDrawnTick.bCanEverTick = true;
+	MenuDrawnTick.bStartWithTickEnabled = false;
+	MenuDrawnTick.TickGroup = TG_PostUpdateWork;
+
+	LeftHandSettings.GripMotionSource = TEXT("LeftGrip");
+	LeftHandSettings.AimMotionSource = TEXT("LeftAim");
+	RightHandSettings.GripMotionSource = TEXT("RightGrip");
+	RightHandSettings.AimMotionSource = TEXT("RightAim");
+}
+
+void UVRMenuComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	SCOPE_CYCLE_COUNTER(STAT_VRMenuTick);
+
+	// Pawn went away without an unpossess on this machine (e.g. on a client)
+	if (!MenuOwner.IsValid())
+	{
+		ClearMenus();
+		return;
+	}
+
+	for (FVRMenuHandState* State : { &LeftHand, &RightHand })
+	{
+		if (State->bPointerActive)
+		{
+			UpdatePointer(*State);
+		}
+	}
+
+	RefreshTickState();
+}
+
+void UVRMenuComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	ClearMenus();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UVRMenuComponent::RegisterComponentTickFunctions(bool bRegister)
+{
+	Super::RegisterComponentTickFunctions(bRegister);
+
+	if (bRegister)
+	{
+		if (SetupActorComponentTickFunction(&MenuDrawnTick))
+		{
+			MenuDrawnTick.Target = this;
+		}
+	}
+	else if (MenuDrawnTick.IsTickFunctionRegistered())
+	{
+		MenuDrawnTick.UnRegisterTickFunction();
+	}
+}
+
+void UVRMenuComponent::InitializeMenus(ACharacter* InCharacter)
+{
+	if (InCharacter && MenuOwner.Get() == InCharacter) return;
+
+	// Menus live on the pawn, rebuild them for a newly possessed pawn (or just drop them for a non-character one)
+	ClearMenus();
+	if (!InCharacter) return;
+
+	MenuOwner = InCharacter;
+
+	InitializeHand(EVRMenuHand::Left);
+	InitializeHand(EVRMenuHand::Right);
+
+	// Ignore the pawn's body and hands, but not the menus it carries
+	LaserQueryParams = FCollisionQueryParams(SCENE_QUERY_STAT(VRMenuLaser), false);
+	TInlineComponentArray<UPrimitiveComponent*> Primitives(InCharacter);
+	for (const UPrimitiveComponent* Primitive : Primitives)
+	{
+		if (!Primitive->IsA<UWidgetComponent>())
+		{
+			LaserQueryParams.AddIgnoredComponent(Primitive);
+		}
+	}
+
+	// Build every menu up front so the first toggle never constructs widgets
+	for (const EVRMenuHand Hand : { EVRMenuHand::Left, EVRMenuHand::Right })
+	{
+		if (const TSubclassOf<UUserWidget> WidgetClass = GetSettings(Hand).MenuWidgetClass)
+		{
+			CreatePooledMenu(WidgetClass);
+		}
+	}
+}
+
+void UVRMenuComponent::ToggleMenu(EVRMenuHand Hand)
+{
+	if (IsMenuOpen(Hand))
+	{
+		CloseMenu(Hand);
+	}
+	else
+	{
+		OpenMenu(Hand);
+	}
+}
+
+bool UVRMenuComponent::IsMenuOpen(EVRMenuHand Hand) const
+{
+	return GetState(Hand).ActiveMenu != nullptr;
+}
+
+void UVRMenuComponent::RequestMenuRedraw(EVRMenuHand Hand)
+{
+	if (UWidgetComponent* Menu = GetState(Hand).ActiveMenu)
+	{
+		Menu->RequestRedraw();
+		INC_DWORD_STAT(STAT_VRMenuRedraws);
+	}
+}
+
+bool UVRMenuComponent::FindMenuHand(const UUserWidget* MenuWidget, EVRMenuHand& OutHand) const
+{
+	if (!MenuWidget) return false;
+
+	for (const EVRMenuHand Hand : { EVRMenuHand::Left, EVRMenuHand::Right })
+	{
+		const UWidgetComponent* Menu = GetState(Hand).ActiveMenu;
+		if (Menu && Menu->GetUserWidgetObject() == MenuWidget)
+		{
+			OutHand = Hand;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void UVRMenuComponent::PressPointer(EVRMenuHand Hand)
+{
+	const FVRMenuHandState& State = GetState(Hand);
+	if (!State.Interaction || !State.bPointerActive) return;
+
+	State.Interaction->PressPointerKey(EKeys::LeftMouseButton);
+	RedrawHoveredMenu(State);
+}
+
+void UVRMenuComponent::ReleasePointer(EVRMenuHand Hand)
+{
+	const FVRMenuHandState& State = GetState(Hand);
+	if (!State.Interaction || !State.bPointerActive) return;
+
+	State.Interaction->ReleasePointerKey(EKeys::LeftMouseButton);
+	RedrawHoveredMenu(State);
+}
+
+UWidgetComponent* UVRMenuComponent::AcquireMenu(TSubclassOf<UUserWidget> WidgetClass)
+{
+	// Reuse a hidden menu of the same class before building a new one
+	for (UWidgetComponent* Menu : MenuPool)
+	{
+		if (Menu && !Menu->IsVisible() && Menu->GetWidgetClass() == WidgetClass)
+		{
+			return Menu;
+		}
+	}
+
+	return CreatePooledMenu(WidgetClass);
+}
+
+UWidgetComponent* UVRMenuComponent::CreatePooledMenu(TSubclassOf<UUserWidget> WidgetClass)
+{
+	ACharacter* Character = MenuOwner.Get();
+	if (!Character || !WidgetClass) return nullptr;
+
+	UWidgetComponent* Menu = NewObject<UWidgetComponent>(Character);
+	Menu->SetWidgetSpace(EWidgetSpace::World);
+	Menu->SetWidgetClass(WidgetClass);
+	Menu->SetDrawSize(MenuDrawSize);
+	Menu->SetTwoSided(false);
+	Menu->SetWindowFocusable(false);
+	// Open menus only draw on request, so ticking while out of view is cheap and keeps the open draw on time
+	Menu->SetTickWhenOffscreen(true);
+
+	// Keep the last render target until something actually changes
+	Menu->SetManuallyRedraw(true);
+
+	Menu->SetVisibility(false);
+	Menu->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Menu->PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	// Lets the menu widget reach this component through GetOwningPlayer
+	if (const APlayerController* PlayerController = Character->GetController<APlayerController>())
+	{
+		Menu->SetOwnerPlayer(PlayerController->GetLocalPlayer());
+	}
+
+	Menu->RegisterComponent();
+	Menu->InitWidget();
+
+	// Draw after the pointers have updated hover, so a requested redraw shows this frame's state
+	Menu->AddTickPrerequisiteComponent(this);
+
+	MenuPool.Add(Menu);
+	SET_DWORD_STAT(STAT_VRMenuPoolSize, MenuPool.Num());
+	INC_DWORD_STAT(STAT_VRMenuCreated);
+
+	return Menu;
+}
+
+void UVRMenuComponent::ReleaseMenu(UWidgetComponent* Menu)
+{
+	if (!Menu) return;
+
+	// Hidden menus stay attached and keep their widget, they just stop costing anything
+	Menu->SetVisibility(false);
+	Menu->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Menu->SetComponentTickEnabled(false);
+}
+
+void UVRMenuComponent::ClearMenus()
+{
+	for (FVRMenuHandState* State : { &LeftHand, &RightHand })
+	{
+		if (IsValid(State->Interaction))
+		{
+			State->Interaction->DestroyComponent();
+		}
+
+		if (IsValid(State->Laser))
+		{
+			State->Laser->DestroyComponent();
+		}
+
+		if (State->PendingToggleCycles != 0 && IsValid(State->ActiveMenu))
+		{
+			MenuDrawnTick.RemovePrerequisite(State->ActiveMenu, State->ActiveMenu->PrimaryComponentTick);
+		}
+
+		*State = FVRMenuHandState();
+	}
+
+	for (UWidgetComponent* Menu : MenuPool)
+	{
+		if (IsValid(Menu))
+		{
+			Menu->DestroyComponent();
+		}
+	}
+
+	MenuPool.Reset();
+	SET_DWORD_STAT(STAT_VRMenuPoolSize, 0);
+
+	MenuOwner.Reset();
+	SetComponentTickEnabled(false);
+	MenuDrawnTick.SetTickFunctionEnable(false);
+}
+
+void UVRMenuComponent::InitializeHand(EVRMenuHand Hand)
+{
+	ACharacter* Character = MenuOwner.Get();
+	if (!Character) return;
+
+	FVRMenuHandState& State = GetState(Hand);
+	const FVRMenuHandSettings& Settings = GetSettings(Hand);
+
+	// Find this hand's Motion Controllers on the pawn
+	TInlineComponentArray<UMotionControllerComponent*> MotionControllers(Character);
+	for (UMotionControllerComponent* MotionController : MotionControllers)
+	{
+		const FName MotionSource = MotionController->GetTrackingMotionSource();
+		if (MotionSource == Settings.GripMotionSource)
+		{
+			State.GripController = MotionController;
+		}
+		if (MotionSource == Settings.AimMotionSource)
+		{
+			State.AimController = MotionController;
+		}
+	}
+
+	if (!State.AimController) return;
+
+	// Pointer is fed our own trace and updated from our tick instead of running its own
+	State.Interaction = NewObject<UVRMenuInteractionComponent>(Character);
+	State.Interaction->InteractionDistance = LaserDistance;
+	State.Interaction->PointerIndex = Hand == EVRMenuHand::Left ? 0 : 1;
+	State.Interaction->SetupAttachment(State.AimController);
+	State.Interaction->RegisterComponent();
+
+	if (LaserSystem)
+	{
+		State.Laser = UNiagaraFunctionLibrary::SpawnSystemAttached(LaserSystem, State.AimController, NAME_None, FVector::ZeroVector, FRotator::ZeroRotator, EAttachLocation::SnapToTarget, false, false);
+	}
+
+	State.LaserPoints.Reserve(2);
+}
+
+void UVRMenuComponent::OpenMenu(EVRMenuHand Hand)
+{
+	SCOPE_CYCLE_COUNTER(STAT_VRMenuToggle);
+
+	if (!MenuOwner.IsValid() || IsMenuOpen(Hand)) return;
+
+	FVRMenuHandState& State = GetState(Hand);
+	const FVRMenuHandSettings& Settings = GetSettings(Hand);
+	if (!State.GripController || !Settings.MenuWidgetClass) return;
+
+	UWidgetComponent* Menu = AcquireMenu(Settings.MenuWidgetClass);
+	if (!Menu) return;
+
+	// Pooled menus may have been shown on the other hand last time
+	if (Menu->GetAttachParent() != State.GripController)
+	{
+		Menu->AttachToComponent(State.GripController, FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+	}
+	Menu->SetRelativeTransform(Settings.MenuOffset);
+
+	Menu->SetVisibility(true);
+	Menu->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+	Menu->RequestRedraw();
+	Menu->SetComponentTickEnabled(true);
+	INC_DWORD_STAT(STAT_VRMenuRedraws);
+
+	State.ActiveMenu = Menu;
+
+	// Time until the menu's own tick has drawn it, see OnMenusDrawn
+	State.PendingToggleCycles = FPlatformTime::Cycles64();
+	MenuDrawnTick.AddPrerequisite(Menu, Menu->PrimaryComponentTick);
+	MenuDrawnTick.SetTickFunctionEnable(true);
+
+	// Point at this menu with the other hand
+	SetPointerActive(GetOtherHand(Hand), true);
+	RefreshTickState();
+}
+
+void UVRMenuComponent::CloseMenu(EVRMenuHand Hand)
+{
+	SCOPE_CYCLE_COUNTER(STAT_VRMenuToggle);
+
+	if (!IsMenuOpen(Hand)) return;
+
+	FVRMenuHandState& State = GetState(Hand);
+
+	if (State.PendingToggleCycles != 0 && State.ActiveMenu)
+	{
+		MenuDrawnTick.RemovePrerequisite(State.ActiveMenu, State.ActiveMenu->PrimaryComponentTick);
+	}
+
+	ReleaseMenu(State.ActiveMenu);
+	State.ActiveMenu = nullptr;
+	State.PendingToggleCycles = 0;
+
+	SetPointerActive(GetOtherHand(Hand), false);
+	RefreshTickState();
+}
+
+void UVRMenuComponent::SetPointerActive(EVRMenuHand Hand, bool bActive)
+{
+	FVRMenuHandState& State = GetState(Hand);
+
+	if (State.Interaction)
+	{
+		if (!bActive && State.bPointerActive)
+		{
+			// Don't leave a press or hover stuck on a hidden menu, Slate sees the empty hit right away
+			State.Interaction->ReleasePointerKey(EKeys::LeftMouseButton);
+			State.LaserHit.Init();
+			State.Interaction->SetCustomHitResult(State.LaserHit);
+			State.Interaction->UpdateHover();
+
+			RedrawHoveredMenu(State);
+			State.HoveredMenu = nullptr;
+			State.HoveredSlateWidget.Reset();
+		}
+		State.bPointerActive = bActive;
+	}
+
+	if (State.Laser)
+	{
+		if (bActive)
+		{
+			State.Laser->Activate(true);
+		}
+		else
+		{
+			State.Laser->DeactivateImmediate();
+		}
+	}
+}
+
+void UVRMenuComponent::UpdatePointer(FVRMenuHandState& State)
+{
+	SCOPE_CYCLE_COUNTER(STAT_VRMenuLaserTrace);
+
+	UWorld* World = GetWorld();
+	if (!World || !State.AimController) return;
+
+	const FVector Start = State.AimController->GetComponentLocation();
+	const FVector End = Start + State.AimController->GetForwardVector() * LaserDistance;
+
+	// Trace into the reused hit result, a miss still needs the trace line for the pointer
+	if (!World->LineTraceSingleByChannel(State.LaserHit, Start, End, LaserTraceChannel, LaserQueryParams))
+	{
+		State.LaserHit.Init(Start, End);
+	}
+	State.Interaction->SetCustomHitResult(State.LaserHit);
+	State.Interaction->UpdateHover();
+
+	UWidgetComponent* HoveredMenu = State.Interaction->GetHoveredWidgetComponent();
+	if (HoveredMenu != LeftHand.ActiveMenu && HoveredMenu != RightHand.ActiveMenu)
+	{
+		HoveredMenu = nullptr;
+	}
+	const TWeakPtr<SWidget> HoveredSlateWidget = State.Interaction->GetHoveredSlateWidget();
+
+	// Resting on the same widget draws nothing, only a change of hover does
+	if (HoveredMenu != State.HoveredMenu)
+	{
+		// One last redraw for the menu we just left so it doesn't keep a stale hover state
+		RedrawHoveredMenu(State);
+		State.HoveredMenu = HoveredMenu;
+		RedrawHoveredMenu(State);
+	}
+	else if (HoveredSlateWidget != State.HoveredSlateWidget)
+	{
+		RedrawHoveredMenu(State);
+	}
+	State.HoveredSlateWidget = HoveredSlateWidget;
+
+	if (State.Laser)
+	{
+		State.LaserPoints.Reset();
+		State.LaserPoints.Add(Start);
+		State.LaserPoints.Add(State.LaserHit.bBlockingHit ? State.LaserHit.ImpactPoint : End);
+		UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector(State.Laser, LaserPointsParameter, State.LaserPoints);
+	}
+}
+
+void UVRMenuComponent::RedrawHoveredMenu(const FVRMenuHandState& State)
+{
+	if (State.HoveredMenu && State.HoveredMenu->IsVisible())
+	{
+		State.HoveredMenu->RequestRedraw();
+		INC_DWORD_STAT(STAT_VRMenuRedraws);
+	}
+}
+
+void UVRMenuComponent::RefreshTickState()
+{
+	SetComponentTickEnabled(IsMenuOpen(EVRMenuHand::Left) || IsMenuOpen(EVRMenuHand::Right));
+}
+
+void UVRMenuComponent::OnMenusDrawn()
+{
+	// Prerequisites put this after the opened menus' ticks, which is where they draw to their render targets
+	for (FVRMenuHandState* State : { &LeftHand, &RightHand })
+	{
+		if (State->PendingToggleCycles == 0 || !State->ActiveMenu) continue;
+
+		const float LatencyMs = static_cast<float>(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - State->PendingToggleCycles));
+		SET_FLOAT_STAT(STAT_VRMenuToggleLatency, LatencyMs);
+		UE_LOG(LogVRMenu, Verbose, TEXT("Menu open to first draw: %.3f ms"), LatencyMs);
+
+		MenuDrawnTick.RemovePrerequisite(State->ActiveMenu, State->ActiveMenu->PrimaryComponentTick);
+		State->PendingToggleCycles = 0;
+	}
+
+	MenuDrawnTick.SetTickFunctionEnable(false);
+}
+
+void FVRMenuDrawnTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (IsValid(Target))
+	{
+		Target->OnMenusDrawn();
+	}
+}
+
+FString FVRMenuDrawnTickFunction::DiagnosticMessage()
+{
+	return Target ? Target->GetFullName() + TEXT("[MenuDrawnTick]") : TEXT("VRMenuDrawnTick");
+}
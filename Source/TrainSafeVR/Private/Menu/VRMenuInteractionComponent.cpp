@@ -0,0 +1,27 @@
+// Copyright © 2024 Luis M. Infante
+// Licensed under the GNU General Public License v3.0 (GPLv3).
+// See the full license at https://www.gnu.org/licenses/gpl-3.0.html.
+
+
+#include "Menu/VRMenuInteractionComponent.h"
+
+#include "Widgets/SWidget.h"
+
+UVRMenuInteractionComponent::UVRMenuInteractionComponent()
+{
+	// Driven by UVRMenuComponent
+	PrimaryComponentTick.bCanEverTick = false;
+
+	InteractionSource = EWidgetInteractionSource::Custom;
+	bShowDebug = false;
+}
+
+void UVRMenuInteractionComponent::UpdateHover()
+{
+	SimulatePointerMovement();
+}
+
+TWeakPtr<SWidget> UVRMenuInteractionComponent::GetHoveredSlateWidget() const
+{
+	return LastWidgetPath.GetLastWidget();
+}
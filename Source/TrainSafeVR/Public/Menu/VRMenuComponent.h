@@ -0,0 +1,208 @@
+// Copyright © 2024 Luis M. Infante
+// Licensed under the GNU General Public License v3.0 (GPLv3).
+// See the full license at https://www.gnu.org/licenses/gpl-3.0.html.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Engine/HitResult.h"
+#include "VRMenuComponent.generated.h"
+
+/*
+	* Wrist/Hand Menus
+	* Widgets are built once and pooled; toggling only shows, hides and re-attaches them.
+	* Open menus keep their last render target and only redraw on open, when the widget under
+	* the pointer changes, on pointer press/release
+	* and when RequestMenuRedraw is called. Anything that changes a menu's content outside of
+	* pointer input (bound text, readouts, Blueprint state) must call RequestMenuRedraw.
+	* Closed menus and the laser stop ticking entirely.
+	* Menu widgets can reach this component through their owning player controller.
+*/
+
+class ACharacter;
+class UVRMenuComponent;
+class UUserWidget;
+class UWidgetComponent;
+class UVRMenuInteractionComponent;
+class SWidget;
+class UMotionControllerComponent;
+class UNiagaraSystem;
+class UNiagaraComponent;
+
+UENUM(BlueprintType)
+enum class EVRMenuHand : uint8
+{
+	Left,
+	Right
+};
+
+USTRUCT(BlueprintType)
+struct FVRMenuHandSettings
+{
+	GENERATED_BODY()
+
+	// Widget shown on this hand's wrist, leave empty to disable the menu for this hand
+	UPROPERTY(EditAnywhere, Category = "Menu", meta = (DisplayName = "Menu Widget Class"))
+	TSubclassOf<UUserWidget> MenuWidgetClass;
+
+	// Motion source the menu is attached to
+	UPROPERTY(EditAnywhere, Category = "Menu", meta = (DisplayName = "Grip Motion Source"))
+	FName GripMotionSource;
+
+	// Motion source the laser is fired from when this hand points at the other hand's menu
+	UPROPERTY(EditAnywhere, Category = "Menu", meta = (DisplayName = "Aim Motion Source"))
+	FName AimMotionSource;
+
+	// Menu placement relative to the grip controller
+	UPROPERTY(EditAnywhere, Category = "Menu", meta = (DisplayName = "Menu Offset"))
+	FTransform MenuOffset;
+};
+
+USTRUCT()
+struct FVRMenuHandState
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<UMotionControllerComponent> GripController;
+	UPROPERTY()
+	TObjectPtr<UMotionControllerComponent> AimController;
+
+	// Pooled widget currently open on this hand, null when closed
+	UPROPERTY()
+	TObjectPtr<UWidgetComponent> ActiveMenu;
+
+	// Menu and widget this hand's pointer hovered last frame, a redraw is only needed when they change
+	UPROPERTY()
+	TObjectPtr<UWidgetComponent> HoveredMenu;
+	TWeakPtr<SWidget> HoveredSlateWidget;
+
+	UPROPERTY()
+	TObjectPtr<UVRMenuInteractionComponent> Interaction;
+	UPROPERTY()
+	TObjectPtr<UNiagaraComponent> Laser;
+
+	// Pointer is tracing at the other hand's open menu
+	bool bPointerActive = false;
+
+	// Reused every frame so pointing never allocates
+	FHitResult LaserHit;
+	TArray<FVector> LaserPoints;
+
+	// Set when the menu opens, cleared once the menu has drawn its first frame
+	uint64 PendingToggleCycles = 0;
+};
+
+// Runs after the opened menus have ticked (and drawn) to time open-to-first-draw
+USTRUCT()
+struct FVRMenuDrawnTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	UVRMenuComponent* Target = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FVRMenuDrawnTickFunction> : public TStructOpsTypeTraitsBase2<FVRMenuDrawnTickFunction>
+{
+	enum { WithCopy = false };
+};
+
+UCLASS(ClassGroup = (VR), meta = (BlueprintSpawnableComponent))
+class TRAINSAFEVR_API UVRMenuComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UVRMenuComponent();
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/* Menus */
+	void InitializeMenus(ACharacter* InCharacter);
+	void ClearMenus();
+
+	UFUNCTION(BlueprintCallable, Category = "Menu")
+	void ToggleMenu(EVRMenuHand Hand);
+	UFUNCTION(BlueprintCallable, Category = "Menu")
+	void OpenMenu(EVRMenuHand Hand);
+	UFUNCTION(BlueprintCallable, Category = "Menu")
+	void CloseMenu(EVRMenuHand Hand);
+	UFUNCTION(BlueprintPure, Category = "Menu")
+	bool IsMenuOpen(EVRMenuHand Hand) const;
+
+	// Redraw an open menu after its content changed
+	UFUNCTION(BlueprintCallable, Category = "Menu")
+	void RequestMenuRedraw(EVRMenuHand Hand);
+
+	// Hand a menu widget is open on, lets the widget redraw or close itself
+	UFUNCTION(BlueprintCallable, Category = "Menu")
+	bool FindMenuHand(const UUserWidget* MenuWidget, EVRMenuHand& OutHand) const;
+
+	/* Pointer */
+	void PressPointer(EVRMenuHand Hand);
+	void ReleasePointer(EVRMenuHand Hand);
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void RegisterComponentTickFunctions(bool bRegister) override;
+
+private:
+	/* Pool */
+	UWidgetComponent* AcquireMenu(TSubclassOf<UUserWidget> WidgetClass);
+	UWidgetComponent* CreatePooledMenu(TSubclassOf<UUserWidget> WidgetClass);
+	void ReleaseMenu(UWidgetComponent* Menu);
+
+	/* Hands */
+	void InitializeHand(EVRMenuHand Hand);
+	void SetPointerActive(EVRMenuHand Hand, bool bActive);
+	void UpdatePointer(FVRMenuHandState& State);
+	void RedrawHoveredMenu(const FVRMenuHandState& State);
+	void RefreshTickState();
+
+	/* Profiling */
+	friend struct FVRMenuDrawnTickFunction;
+	void OnMenusDrawn();
+
+	FORCEINLINE FVRMenuHandState& GetState(EVRMenuHand Hand) { return Hand == EVRMenuHand::Left ? LeftHand : RightHand; }
+	FORCEINLINE const FVRMenuHandState& GetState(EVRMenuHand Hand) const { return Hand == EVRMenuHand::Left ? LeftHand : RightHand; }
+	FORCEINLINE const FVRMenuHandSettings& GetSettings(EVRMenuHand Hand) const { return Hand == EVRMenuHand::Left ? LeftHandSettings : RightHandSettings; }
+	FORCEINLINE static EVRMenuHand GetOtherHand(EVRMenuHand Hand) { return Hand == EVRMenuHand::Left ? EVRMenuHand::Right : EVRMenuHand::Left; }
+
+private:
+	/* Menu Properties */
+	UPROPERTY(EditAnywhere, Category = "Menu", meta = (DisplayName = "Left Hand"))
+	FVRMenuHandSettings LeftHandSettings;
+	UPROPERTY(EditAnywhere, Category = "Menu", meta = (DisplayName = "Right Hand"))
+	FVRMenuHandSettings RightHandSettings;
+	UPROPERTY(EditAnywhere, Category = "Menu", meta = (DisplayName = "Menu Draw Size"))
+	FVector2D MenuDrawSize = FVector2D(500.0f, 500.0f);
+
+	/* Laser Properties */
+	UPROPERTY(EditAnywhere, Category = "Laser", meta = (DisplayName = "Laser System"))
+	TObjectPtr<UNiagaraSystem> LaserSystem;
+	UPROPERTY(EditAnywhere, Category = "Laser", meta = (DisplayName = "Laser Points Parameter"))
+	FName LaserPointsParameter = TEXT("User.PointArray");
+	UPROPERTY(EditAnywhere, Category = "Laser", meta = (DisplayName = "Laser Distance"))
+	float LaserDistance = 500.0f;
+	UPROPERTY(EditAnywhere, Category = "Laser", meta = (DisplayName = "Laser Trace Channel"))
+	TEnumAsByte<ECollisionChannel> LaserTraceChannel = ECC_Visibility;
+
+	/* Hand State */
+	UPROPERTY()
+	FVRMenuHandState LeftHand;
+	UPROPERTY()
+	FVRMenuHandState RightHand;
+
+	/* Widget Pool */
+	UPROPERTY()
+	TArray<TObjectPtr<UWidgetComponent>> MenuPool;
+
+	FVRMenuDrawnTickFunction MenuDrawnTick;
+
+	TWeakObjectPtr<ACharacter> MenuOwner;
+	FCollisionQueryParams LaserQueryParams;
+};
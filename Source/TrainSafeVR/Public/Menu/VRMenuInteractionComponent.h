@@ -0,0 +1,32 @@
+// Copyright © 2024 Luis M. Infante
+// Licensed under the GNU General Public License v3.0 (GPLv3).
+// See the full license at https://www.gnu.org/licenses/gpl-3.0.html.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/WidgetInteractionComponent.h"
+#include "VRMenuInteractionComponent.generated.h"
+
+/*
+	* Menu Pointer
+	* Never ticks on its own, UVRMenuComponent updates hover right after feeding it the laser hit
+	* so hover (and any redraw it needs) is resolved in the same frame.
+*/
+
+class SWidget;
+
+UCLASS(ClassGroup = (VR))
+class TRAINSAFEVR_API UVRMenuInteractionComponent : public UWidgetInteractionComponent
+{
+	GENERATED_BODY()
+
+public:
+	UVRMenuInteractionComponent();
+
+	// Routes the current custom hit result to Slate
+	void UpdateHover();
+
+	// Deepest widget under the pointer as of the last UpdateHover
+	TWeakPtr<SWidget> GetHoveredSlateWidget() const;
+};
@@ -10,7 +10,7 @@ public class TrainSafeVR : ModuleRules
 	
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "Niagara", "UMG", "XRBase" });
 
-		PrivateDependencyModuleNames.AddRange(new string[] { "EnhancedInput", "XRBase" });
+		PrivateDependencyModuleNames.AddRange(new string[] { "EnhancedInput", "HeadMountedDisplay", "XRBase" });
 
 		// Uncomment if you are using Slate UI
 		PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });